@@ -0,0 +1,14 @@
+/*
+  ==============================================================================
+
+    Stand-in for the Projucer generated JuceHeader.h, so the plugin sources
+    can be compiled into the Python module with JUCE's CMake targets.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_dsp/juce_dsp.h>
+#include <juce_gui_extra/juce_gui_extra.h>
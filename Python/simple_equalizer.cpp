@@ -0,0 +1,290 @@
+/*
+  ==============================================================================
+
+    Python bindings for running the plugin's EQ over datasets.
+
+    Filters are designed through getChainSettings, makePeakFilter,
+    makeHighPassFilter and makeLowPassFilter exactly as the plugin does.
+    float32 arrays run through the float block engine with float designs,
+    like realtime playback; float64 arrays run through the double precision
+    block engine with double designs, like offline renders. Arrays are
+    filtered in place and the GIL is released while processing.
+
+  ==============================================================================
+*/
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+namespace py = pybind11;
+
+namespace
+{
+    // The parameter tree runs a timer, which needs a message manager.
+    void ensureJuceInitialised()
+    {
+        static juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    }
+    
+    // Goes through a real processor's parameters so values are clamped and
+    // snapped to their ranges the same way host automation would be.
+    ChainSettings chainSettingsFromParameters (const std::map<std::string, float>& parameters)
+    {
+        ensureJuceInitialised();
+        
+        static std::mutex mutex;
+        static SimpleEqualizerAudioProcessor processor;
+        
+        std::lock_guard<std::mutex> lock (mutex);
+        
+        for (auto* parameter : processor.getParameters())
+            parameter->setValueNotifyingHost (parameter->getDefaultValue());
+        
+        for (const auto& [parameterID, value] : parameters)
+        {
+            auto* parameter = processor.apvts.getParameter (juce::String (parameterID));
+            
+            if (parameter == nullptr)
+                throw py::key_error ("Unknown parameter: " + parameterID);
+            
+            parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+        }
+        
+        return getChainSettings (processor.apvts);
+    }
+    
+    // The designers assume every frequency lies strictly between 0 and
+    // Nyquist; outside that range they silently produce a different filter
+    // (e.g. the default 20 kHz low pass folds down to ~4 kHz at 16 kHz).
+    // The comparisons are written so that NaN fails them too.
+    void validateSettings (const ChainSettings& chainSettings, double sampleRate)
+    {
+        const auto nyquist = sampleRate / 2.0;
+        
+        auto checkFrequency = [nyquist] (const char* name, float frequency)
+        {
+            if (! (frequency > 0.f && frequency < nyquist))
+                throw py::value_error (std::string (name) + " must be above 0 and below sample_rate / 2 ("
+                                       + std::to_string (nyquist) + " Hz), got " + std::to_string (frequency));
+        };
+        
+        checkFrequency ("high_pass_freq", chainSettings.highPassFreq);
+        checkFrequency ("low_pass_freq", chainSettings.lowPassFreq);
+        checkFrequency ("peak_freq", chainSettings.peakFreq);
+        
+        if (! (chainSettings.peakQuality > 0.f))
+            throw py::value_error ("peak_quality must be positive, got " + std::to_string (chainSettings.peakQuality));
+    }
+    
+    void updateChain (MonoChain& chain, const ChainSettings& chainSettings, double sampleRate)
+    {
+        updateCoefficients (chain.get<ChainPositions::Peak>().coefficients, makePeakFilter (chainSettings, sampleRate));
+        updatePassFilter (chain.get<ChainPositions::HighPass>(), makeHighPassFilter (chainSettings, sampleRate), chainSettings.highPassSlope);
+        updatePassFilter (chain.get<ChainPositions::LowPass>(), makeLowPassFilter (chainSettings, sampleRate), chainSettings.lowPassSlope);
+    }
+    
+    bool isSampleFormat (const py::buffer_info& info, const std::string& format)
+    {
+        return info.format == format && info.itemsize == (py::ssize_t) (format == "f" ? sizeof (float) : sizeof (double));
+    }
+}
+
+// Filters one or more channels, keeping state between calls like the plugin
+// does between blocks. A single Equalizer must only be used from one thread
+// at a time; create one per worker to process batches in parallel.
+class Equalizer
+{
+public:
+    Equalizer (double sampleRateToUse, const ChainSettings& chainSettings)
+        : sampleRate (sampleRateToUse)
+    {
+        if (sampleRate <= 0)
+            throw py::value_error ("sample_rate must be positive");
+        
+        juce::dsp::ProcessSpec spec;
+        spec.maximumBlockSize = 1 << 16;
+        spec.numChannels = 1;
+        spec.sampleRate = sampleRate;
+        floatDesign.prepare (spec);
+        
+        setSettings (chainSettings);
+    }
+    
+    ChainSettings getSettings() const { return settings; }
+    
+    void setSettings (const ChainSettings& chainSettings)
+    {
+        validateSettings (chainSettings, sampleRate);
+        
+        settings = chainSettings;
+        updateChain (floatDesign, settings, sampleRate);
+        
+        for (auto& chain : floatChains)
+            mirrorChain (chain, floatDesign);
+        
+        for (auto& chain : doubleChains)
+            designChain (chain, settings, sampleRate);
+    }
+    
+    void reset()
+    {
+        for (auto& chain : floatChains)
+            chain.reset();
+        
+        for (auto& chain : doubleChains)
+            chain.reset();
+    }
+    
+    void process (py::array samples)
+    {
+        if ((samples.flags() & py::array::c_style) == 0)
+            throw py::value_error ("samples must be C-contiguous");
+        
+        auto info = samples.request (true);
+        
+        if (info.ndim != 1 && info.ndim != 2)
+            throw py::value_error ("samples must have shape (samples,) or (channels, samples)");
+        
+        // The filter chains count samples in int.
+        for (auto extent : info.shape)
+            if (extent > (py::ssize_t) std::numeric_limits<int>::max())
+                throw py::value_error ("samples must have at most " + std::to_string (std::numeric_limits<int>::max())
+                                       + " channels and samples per channel");
+        
+        const auto numChannels = info.ndim == 1 ? 1 : (int) info.shape[0];
+        const auto numSamples = (int) info.shape[(size_t) info.ndim - 1];
+        
+        if (isSampleFormat (info, py::format_descriptor<float>::format()))
+        {
+            while ((int) floatChains.size() < numChannels)
+            {
+                floatChains.emplace_back();
+                mirrorChain (floatChains.back(), floatDesign);
+            }
+            
+            auto* data = static_cast<float*> (info.ptr);
+            py::gil_scoped_release release;
+            
+            for (int channel = 0; channel < numChannels; ++channel)
+                floatChains[(size_t) channel].process (data + (size_t) channel * (size_t) numSamples, numSamples);
+        }
+        else if (isSampleFormat (info, py::format_descriptor<double>::format()))
+        {
+            while ((int) doubleChains.size() < numChannels)
+            {
+                doubleChains.emplace_back();
+                designChain (doubleChains.back(), settings, sampleRate);
+            }
+            
+            auto* data = static_cast<double*> (info.ptr);
+            py::gil_scoped_release release;
+            
+            for (int channel = 0; channel < numChannels; ++channel)
+                doubleChains[(size_t) channel].process (data + (size_t) channel * (size_t) numSamples, numSamples);
+        }
+        else
+        {
+            throw py::type_error ("samples must be float32 or float64");
+        }
+    }
+    
+private:
+    double sampleRate;
+    ChainSettings settings;
+    
+    // Holds the float designs that the float chains mirror, as the
+    // processor's MonoChains do for realtime playback.
+    MonoChain floatDesign;
+    
+    std::vector<BlockMonoChain<float>> floatChains;
+    std::vector<BlockMonoChain<double>> doubleChains;
+};
+
+// Returns linear magnitudes with shape (len (settings), len (frequencies)).
+static py::array_t<double> magnitudeResponse (const std::vector<ChainSettings>& settings,
+                                              py::array_t<double, py::array::c_style | py::array::forcecast> frequencies,
+                                              double sampleRate)
+{
+    if (sampleRate <= 0)
+        throw py::value_error ("sample_rate must be positive");
+    
+    for (const auto& chainSettings : settings)
+        validateSettings (chainSettings, sampleRate);
+    
+    const auto numFrequencies = (size_t) frequencies.size();
+    py::array_t<double> magnitudes ({ (py::ssize_t) settings.size(), (py::ssize_t) numFrequencies });
+    
+    const auto* frequencyData = frequencies.data();
+    auto* magnitudeData = magnitudes.mutable_data();
+    
+    {
+        py::gil_scoped_release release;
+        std::vector<double> sectionMagnitudes (numFrequencies);
+        
+        for (size_t i = 0; i < settings.size(); ++i)
+        {
+            auto* row = magnitudeData + i * numFrequencies;
+            std::fill (row, row + numFrequencies, 1.0);
+        
+            auto applySection = [&] (const juce::dsp::IIR::Coefficients<float>& section)
+            {
+                section.getMagnitudeForFrequencyArray (frequencyData, sectionMagnitudes.data(), numFrequencies, sampleRate);
+                juce::FloatVectorOperations::multiply (row, sectionMagnitudes.data(), (int) numFrequencies);
+            };
+        
+            for (auto* section : makeHighPassFilter (settings[i], sampleRate))
+                applySection (*section);
+        
+            applySection (*makePeakFilter (settings[i], sampleRate));
+        
+            for (auto* section : makeLowPassFilter (settings[i], sampleRate))
+                applySection (*section);
+        }
+    }
+    
+    return magnitudes;
+}
+
+PYBIND11_MODULE (simple_equalizer, m)
+{
+    m.doc() = "SimpleEqualizer's filter chain for batch processing NumPy arrays.";
+    
+    py::enum_<Slope> (m, "Slope")
+        .value ("Slope_6", Slope_6)
+        .value ("Slope_12", Slope_12)
+        .value ("Slope_18", Slope_18)
+        .value ("Slope_24", Slope_24)
+        .value ("Slope_30", Slope_30)
+        .value ("Slope_36", Slope_36);
+    
+    py::class_<ChainSettings> (m, "ChainSettings")
+        .def (py::init ([] { return chainSettingsFromParameters ({}); }),
+              "Starts from the plugin's default parameter values, like chain_settings().")
+        .def_readwrite ("high_pass_freq", &ChainSettings::highPassFreq)
+        .def_readwrite ("low_pass_freq", &ChainSettings::lowPassFreq)
+        .def_readwrite ("peak_freq", &ChainSettings::peakFreq)
+        .def_readwrite ("peak_gain_db", &ChainSettings::peakGainInDecibels)
+        .def_readwrite ("peak_quality", &ChainSettings::peakQuality)
+        .def_readwrite ("high_pass_slope", &ChainSettings::highPassSlope)
+        .def_readwrite ("low_pass_slope", &ChainSettings::lowPassSlope);
+    
+    m.def ("chain_settings", &chainSettingsFromParameters, py::arg ("parameters") = std::map<std::string, float>(),
+           "Builds ChainSettings from plugin parameter values keyed by parameter ID, e.g. {\"Peak Gain\": 6.0}. "
+           "Parameters that aren't given take their default values.");
+    
+    py::class_<Equalizer> (m, "Equalizer")
+        .def (py::init<double, const ChainSettings&>(), py::arg ("sample_rate"), py::arg ("settings"),
+              "Raises ValueError if a frequency isn't strictly between 0 and sample_rate / 2, or peak_quality isn't positive.")
+        .def_property ("settings", &Equalizer::getSettings, &Equalizer::setSettings)
+        .def ("reset", &Equalizer::reset, "Clears the filter state of every channel.")
+        .def ("process", &Equalizer::process, py::arg ("samples"),
+              "Filters a C-contiguous float32 or float64 array of shape (samples,) or (channels, samples) in place.");
+    
+    m.def ("magnitude_response", &magnitudeResponse, py::arg ("settings"), py::arg ("frequencies"), py::arg ("sample_rate"),
+           "Linear magnitude of the full chain for each ChainSettings at each frequency. "
+           "Raises ValueError if any settings are invalid at sample_rate.");
+}
@@ -0,0 +1,275 @@
+/*
+  ==============================================================================
+
+    Block state-space IIR engine.
+
+    juce::dsp::IIR::Filter runs each section as a sample-by-sample recurrence,
+    so a single channel gets no vector parallelism. BlockBiquad rewrites a
+    transposed direct form II section as a state-space system and advances it
+    blockLength samples at a time:
+
+        y[k]       = C A^k s + sum_{j<=k} h[k-j] u[j]
+        s[n + L]   = A^L s + sum_j A^(L-1-j) B u[j]
+
+    Every output of a block only depends on the state at the start of the
+    block and the block's inputs, so the inner loops are independent across
+    samples and vectorise. The state is the same (s1, s2) pair that the TDF-II
+    recurrence keeps, so leftover samples, and whole calls too short for the
+    block path to pay off, simply run through the recurrence. Switching
+    between the two never disturbs the output.
+
+    TraceReplay --benchmark compares the block path with the juce::dsp
+    cascade per block size.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+template <typename SampleType>
+class BlockBiquad
+{
+public:
+    static constexpr int blockLength = 8;
+
+    // Calls shorter than this run the plain recurrence. The block path is at
+    // parity with the juce::dsp cascade at 16 samples and clearly ahead from
+    // 32; below that the recurrence wins.
+    static constexpr int blockPathThreshold = 32;
+
+    // Accepts float or double designs; the matrices are built in double
+    // either way.
+    template <typename CoefficientType>
+    void setCoefficients (const juce::dsp::IIR::Coefficients<CoefficientType>& newCoefficients)
+    {
+        const auto* c = newCoefficients.getRawCoefficients();
+        const auto order = newCoefficients.getFilterOrder();
+        jassert (order == 1 || order == 2);
+
+        // JUCE stores normalised coefficients as {b0, b1, b2, a1, a2} for
+        // second order sections and {b0, b1, a1} for first order ones.
+        std::array<double, 5> raw { c[0], c[1], 0.0, 0.0, 0.0 };
+
+        if (order == 2)
+        {
+            raw[2] = c[2];
+            raw[3] = c[3];
+            raw[4] = c[4];
+        }
+        else
+        {
+            raw[3] = c[2];
+        }
+
+        if (raw == designed)
+            return;
+
+        designed = raw;
+
+        const auto [db0, db1, db2, da1, da2] = raw;
+
+        b0 = (SampleType) db0;
+        b1 = (SampleType) db1;
+        b2 = (SampleType) db2;
+        a1 = (SampleType) da1;
+        a2 = (SampleType) da2;
+
+        // A = [-a1 1; -a2 0], B = [b1 - a1 b0; b2 - a2 b0], C = [1 0], D = b0.
+        // The matrices are built in double so the float engine only rounds once.
+        const double inputToState[2] { db1 - da1 * db0, db2 - da2 * db0 };
+
+        // powers[k] holds A^k, stored row major.
+        std::array<std::array<double, 4>, blockLength + 1> powers;
+        powers[0] = { 1.0, 0.0, 0.0, 1.0 };
+
+        for (int k = 1; k <= blockLength; ++k)
+        {
+            const auto& p = powers[(size_t) k - 1];
+            powers[(size_t) k] = { -da1 * p[0] + p[2], -da1 * p[1] + p[3],
+                                   -da2 * p[0],        -da2 * p[1] };
+        }
+
+        std::array<double, blockLength> impulse;
+        impulse[0] = db0;
+
+        for (size_t k = 0; k < (size_t) blockLength; ++k)
+        {
+            const auto& p = powers[k];
+
+            fromState0[k] = (SampleType) p[0];
+            fromState1[k] = (SampleType) p[1];
+
+            if (k + 1 < (size_t) blockLength)
+                impulse[k + 1] = p[0] * inputToState[0] + p[1] * inputToState[1];
+        }
+
+        // Row j holds what input j contributes to each output of the block
+        // (zero above the diagonal), followed by its contribution to the
+        // next state, so one pass of whole rows computes both.
+        for (size_t j = 0; j < (size_t) blockLength; ++j)
+        {
+            auto& row = fromInput[j];
+
+            for (size_t k = 0; k < (size_t) blockLength; ++k)
+                row[k] = k >= j ? (SampleType) impulse[k - j] : SampleType (0);
+
+            const auto& q = powers[(size_t) blockLength - 1 - j];
+            row[blockLength]     = (SampleType) (q[0] * inputToState[0] + q[1] * inputToState[1]);
+            row[blockLength + 1] = (SampleType) (q[2] * inputToState[0] + q[3] * inputToState[1]);
+        }
+
+        const auto& last = powers[(size_t) blockLength];
+        carry = last;
+    }
+
+    void reset() noexcept
+    {
+        state = {};
+    }
+
+    template <typename OtherType>
+    void copyStateFrom (const BlockBiquad<OtherType>& other) noexcept
+    {
+        state = other.getState();
+    }
+
+    std::array<double, 2> getState() const noexcept
+    {
+        return state;
+    }
+
+    void process (SampleType* samples, int numSamples) noexcept
+    {
+        auto s0 = state[0];
+        auto s1 = state[1];
+
+        int n = 0;
+
+        if (numSamples >= blockPathThreshold)
+        {
+            for (; n + blockLength <= numSamples; n += blockLength)
+            {
+                const auto* u = samples + n;
+                const auto state0 = (SampleType) s0;
+                const auto state1 = (SampleType) s1;
+                SampleType y[rowLength] {};
+
+                for (int k = 0; k < blockLength; ++k)
+                    y[k] = fromState0[(size_t) k] * state0 + fromState1[(size_t) k] * state1;
+
+                for (int j = 0; j < blockLength; ++j)
+                    for (int k = 0; k < rowLength; ++k)
+                        y[k] += fromInput[(size_t) j][(size_t) k] * u[j];
+
+                // The state carries from block to block, so A^L is applied
+                // in double: rounding it to float would shift the poles of
+                // sections that sit close to z = 1. The inputs' share is
+                // added last so it stays off the block-to-block dependency
+                // chain.
+                const auto next0 = carry[0] * s0 + carry[1] * s1 + (double) y[blockLength];
+                const auto next1 = carry[2] * s0 + carry[3] * s1 + (double) y[blockLength + 1];
+
+                s0 = next0;
+                s1 = next1;
+
+                std::copy (y, y + blockLength, samples + n);
+            }
+        }
+
+        if (n < numSamples)
+        {
+            auto r0 = (SampleType) s0;
+            auto r1 = (SampleType) s1;
+
+            for (; n < numSamples; ++n)
+            {
+                const auto input = samples[n];
+                const auto output = b0 * input + r0;
+                r0 = b1 * input - a1 * output + r1;
+                r1 = b2 * input - a2 * output;
+                samples[n] = output;
+            }
+
+            s0 = r0;
+            s1 = r1;
+        }
+
+        state = { s0, s1 };
+    }
+
+private:
+    // blockLength outputs, two state components and padding to a whole
+    // number of SIMD registers.
+    static constexpr int rowLength = blockLength + 4;
+
+    std::array<double, 5> designed {};
+
+    SampleType b0 {}, b1 {}, b2 {}, a1 {}, a2 {};
+
+    std::array<std::array<SampleType, rowLength>, blockLength> fromInput {};
+    std::array<SampleType, blockLength> fromState0 {}, fromState1 {};
+    std::array<double, 4> carry {};
+
+    std::array<double, 2> state {};
+};
+
+/** Mirrors the layout of MonoChain: six high pass sections, the peak filter and
+    six low pass sections, each of which can be bypassed.
+*/
+template <typename SampleType>
+class BlockMonoChain
+{
+public:
+    static constexpr int numSections = 13;
+
+    template <typename CoefficientType>
+    void setSection (int index, const juce::dsp::IIR::Coefficients<CoefficientType>& coefficients, bool bypassed)
+    {
+        jassert (juce::isPositiveAndBelow (index, numSections));
+        sections[(size_t) index].setCoefficients (coefficients);
+        bypassStates[(size_t) index] = bypassed;
+    }
+
+    // Keeps the section's coefficients, for sections a design doesn't use.
+    void bypassSection (int index)
+    {
+        jassert (juce::isPositiveAndBelow (index, numSections));
+        bypassStates[(size_t) index] = true;
+    }
+
+    void reset() noexcept
+    {
+        for (auto& section : sections)
+            section.reset();
+    }
+
+    /** Carries the running filter state over from another engine, e.g. when
+        switching between the float and double precision versions.
+    */
+    template <typename OtherType>
+    void copyStateFrom (const BlockMonoChain<OtherType>& other) noexcept
+    {
+        for (int i = 0; i < numSections; ++i)
+            sections[(size_t) i].copyStateFrom (other.getSection (i));
+    }
+
+    const BlockBiquad<SampleType>& getSection (int index) const noexcept
+    {
+        return sections[(size_t) index];
+    }
+
+    void process (SampleType* samples, int numSamples) noexcept
+    {
+        for (size_t i = 0; i < sections.size(); ++i)
+        {
+            if (! bypassStates[i])
+                sections[i].process (samples, numSamples);
+        }
+    }
+
+private:
+    std::array<BlockBiquad<SampleType>, numSections> sections;
+    std::array<bool, numSections> bypassStates {};
+};
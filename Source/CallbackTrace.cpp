@@ -0,0 +1,282 @@
+/*
+  ==============================================================================
+
+    Opt-in recorder for the host callbacks that drive the processor.
+
+  ==============================================================================
+*/
+
+#include "CallbackTrace.h"
+
+namespace
+{
+    const char* const traceMagic = "SEQT";
+    constexpr int traceVersion = 3;
+}
+
+CallbackTrace::CallbackTrace (const juce::File& file)
+    : juce::Thread ("Callback trace writer"),
+      output (file.getNonexistentSibling())
+{
+    // ChainSettings is copied into the FIFO on the audio thread, so each slot
+    // has to be constructed up front.
+    processEvents.resize (fifoSize);
+    batch.reserve (fifoSize);
+    
+    // A bad SIMPLEEQ_TRACE_FILE is the user's to fix; createFromEnvironment
+    // logs it and drops the recorder.
+    if (output.failedToOpen())
+        return;
+    
+    output.write (traceMagic, 4);
+    output.writeInt (traceVersion);
+    output.writeInt64 (juce::Time::getHighResolutionTicksPerSecond());
+    
+    startThread();
+}
+
+CallbackTrace::~CallbackTrace()
+{
+    if (! isRecording())
+        return;
+    
+    stopThread (2000);
+    writePending();
+    
+    if (totalDroppedEvents > 0)
+        juce::Logger::writeToLog ("Callback trace " + getFile().getFullPathName() + " dropped "
+                                  + juce::String (totalDroppedEvents) + " process events");
+}
+
+std::unique_ptr<CallbackTrace> CallbackTrace::createFromEnvironment()
+{
+    auto path = juce::SystemStats::getEnvironmentVariable ("SIMPLEEQ_TRACE_FILE", {});
+    
+    if (path.isEmpty() || ! juce::File::isAbsolutePath (path))
+        return nullptr;
+    
+    auto trace = std::make_unique<CallbackTrace> (juce::File (path));
+    
+    if (! trace->isRecording())
+    {
+        juce::Logger::writeToLog ("Couldn't open callback trace " + trace->getFile().getFullPathName());
+        return nullptr;
+    }
+    
+    juce::Logger::writeToLog ("Recording callback trace to " + trace->getFile().getFullPathName());
+    return trace;
+}
+
+void CallbackTrace::recordPrepare (double sampleRate, int samplesPerBlock, juce::int64 startTicks)
+{
+    CallbackEvent event;
+    event.type = CallbackType::Prepare;
+    event.sequence = nextSequence++;
+    event.startTicks = startTicks;
+    event.durationTicks = juce::Time::getHighResolutionTicks() - startTicks;
+    event.sampleRate = sampleRate;
+    event.numSamples = samplesPerBlock;
+    
+    const juce::ScopedLock sl (messageLock);
+    messageEvents.push_back (std::move (event));
+}
+
+void CallbackTrace::recordSetState (const void* data, int sizeInBytes, juce::int64 startTicks)
+{
+    CallbackEvent event;
+    event.type = CallbackType::SetState;
+    event.sequence = nextSequence++;
+    event.startTicks = startTicks;
+    event.durationTicks = juce::Time::getHighResolutionTicks() - startTicks;
+    event.state.append (data, (size_t) sizeInBytes);
+    
+    const juce::ScopedLock sl (messageLock);
+    messageEvents.push_back (std::move (event));
+}
+
+void CallbackTrace::recordProcess (int numSamples, bool nonRealtime, const ChainSettings& settings,
+                                   bool meteringEnabled, juce::int64 startTicks) noexcept
+{
+    const auto endTicks = juce::Time::getHighResolutionTicks();
+    const auto scope = processFifo.write (1);
+    
+    if (scope.blockSize1 == 0)
+    {
+        ++droppedEvents;
+        return;
+    }
+    
+    auto& event = processEvents[(size_t) scope.startIndex1];
+    event.type = CallbackType::Process;
+    event.sequence = nextSequence++;
+    event.startTicks = startTicks;
+    event.durationTicks = endTicks - startTicks;
+    event.numSamples = numSamples;
+    event.nonRealtime = nonRealtime;
+    event.settings = settings;
+    event.meteringEnabled = meteringEnabled;
+}
+
+void CallbackTrace::run()
+{
+    while (! threadShouldExit())
+    {
+        wait (50);
+        writePending();
+    }
+}
+
+void CallbackTrace::writePending()
+{
+    {
+        const juce::ScopedLock sl (messageLock);
+        
+        for (auto& event : messageEvents)
+            batch.push_back (std::move (event));
+        
+        messageEvents.clear();
+    }
+    
+    {
+        const auto scope = processFifo.read (processFifo.getNumReady());
+        
+        for (int i = 0; i < scope.blockSize1; ++i)
+            batch.push_back (processEvents[(size_t) (scope.startIndex1 + i)]);
+        
+        for (int i = 0; i < scope.blockSize2; ++i)
+            batch.push_back (processEvents[(size_t) (scope.startIndex2 + i)]);
+    }
+    
+    // The audio thread can take a sequence number before its FIFO write is
+    // visible here, so events may still straddle batches. read() puts them
+    // back in order; sorting here just keeps each batch tidy.
+    std::sort (batch.begin(), batch.end(),
+               [] (const CallbackEvent& a, const CallbackEvent& b) { return a.sequence < b.sequence; });
+    
+    if (auto dropped = droppedEvents.exchange (0))
+    {
+        CallbackEvent event;
+        event.type = CallbackType::Dropped;
+        event.sequence = nextSequence++;
+        event.numSamples = dropped;
+        batch.push_back (std::move (event));
+        
+        totalDroppedEvents += dropped;
+    }
+    
+    for (const auto& event : batch)
+    {
+        output.writeByte ((char) event.type);
+        output.writeInt ((int) event.sequence);
+        output.writeInt64 (event.startTicks);
+        output.writeInt64 (event.durationTicks);
+        
+        switch (event.type)
+        {
+            case CallbackType::Prepare:
+                output.writeDouble (event.sampleRate);
+                output.writeInt (event.numSamples);
+                break;
+                
+            case CallbackType::Process:
+                output.writeInt (event.numSamples);
+                output.writeBool (event.nonRealtime);
+                output.writeFloat (event.settings.highPassFreq);
+                output.writeFloat (event.settings.lowPassFreq);
+                output.writeFloat (event.settings.peakFreq);
+                output.writeFloat (event.settings.peakGainInDecibels);
+                output.writeFloat (event.settings.peakQuality);
+                output.writeByte ((char) event.settings.highPassSlope);
+                output.writeByte ((char) event.settings.lowPassSlope);
+                output.writeBool (event.meteringEnabled);
+                break;
+                
+            case CallbackType::SetState:
+                output.writeInt ((int) event.state.getSize());
+                output.write (event.state.getData(), event.state.getSize());
+                break;
+                
+            case CallbackType::Dropped:
+                output.writeInt (event.numSamples);
+                break;
+        }
+    }
+    
+    batch.clear();
+    output.flush();
+}
+
+juce::Result CallbackTrace::read (const juce::File& file, std::vector<CallbackEvent>& events,
+                                   juce::int64& ticksPerSecond, int& droppedEvents)
+{
+    droppedEvents = 0;
+    
+    juce::FileInputStream input (file);
+    
+    if (input.failedToOpen())
+        return juce::Result::fail ("Couldn't open " + file.getFullPathName());
+    
+    char magic[4] {};
+    
+    if (input.read (magic, 4) != 4 || std::memcmp (magic, traceMagic, 4) != 0)
+        return juce::Result::fail (file.getFileName() + " is not a callback trace");
+    
+    if (input.readInt() != traceVersion)
+        return juce::Result::fail ("Unsupported trace version");
+    
+    ticksPerSecond = input.readInt64();
+    
+    while (! input.isExhausted())
+    {
+        CallbackEvent event;
+        event.type = (CallbackType) input.readByte();
+        event.sequence = (juce::uint32) input.readInt();
+        event.startTicks = input.readInt64();
+        event.durationTicks = input.readInt64();
+        
+        switch (event.type)
+        {
+            case CallbackType::Prepare:
+                event.sampleRate = input.readDouble();
+                event.numSamples = input.readInt();
+                break;
+                
+            case CallbackType::Process:
+                event.numSamples = input.readInt();
+                event.nonRealtime = input.readBool();
+                event.settings.highPassFreq = input.readFloat();
+                event.settings.lowPassFreq = input.readFloat();
+                event.settings.peakFreq = input.readFloat();
+                event.settings.peakGainInDecibels = input.readFloat();
+                event.settings.peakQuality = input.readFloat();
+                event.settings.highPassSlope = static_cast<Slope> (input.readByte());
+                event.settings.lowPassSlope = static_cast<Slope> (input.readByte());
+                event.meteringEnabled = input.readBool();
+                break;
+                
+            case CallbackType::SetState:
+            {
+                auto size = input.readInt();
+                
+                if (size < 0 || input.readIntoMemoryBlock (event.state, size) != (size_t) size)
+                    return juce::Result::fail ("Truncated state event");
+                
+                break;
+            }
+                
+            case CallbackType::Dropped:
+                droppedEvents += input.readInt();
+                continue;
+                
+            default:
+                return juce::Result::fail ("Corrupt trace event");
+        }
+        
+        events.push_back (std::move (event));
+    }
+    
+    std::stable_sort (events.begin(), events.end(),
+                      [] (const CallbackEvent& a, const CallbackEvent& b) { return a.sequence < b.sequence; });
+    
+    return juce::Result::ok();
+}
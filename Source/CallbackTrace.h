@@ -0,0 +1,117 @@
+/*
+  ==============================================================================
+
+    Opt-in recorder for the host callbacks that drive the processor, so that
+    production block-size jitter, automation and preset changes can be
+    replayed headlessly under a profiler (see Tools/TraceReplay).
+
+    Set SIMPLEEQ_TRACE_FILE to a file path before launching the host to
+    enable it. The audio thread only ever pushes into a preallocated
+    lock-free FIFO; a background thread drains it to disk.
+    If the FIFO overflows, the number of lost process events is written to
+    the trace as well, so a replay can tell it is incomplete.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+enum class CallbackType : juce::uint8
+{
+    Prepare = 1,
+    Process = 2,
+    SetState = 3,
+    Dropped = 4
+};
+
+struct CallbackEvent
+{
+    CallbackType type {CallbackType::Process};
+    juce::uint32 sequence {0};
+    juce::int64 startTicks {0}, durationTicks {0};
+    
+    double sampleRate {0};          // Prepare
+    int numSamples {0};             // Prepare: samplesPerBlock, Process: block size, Dropped: event count
+    bool nonRealtime {false};       // Process
+    ChainSettings settings;         // Process
+    bool meteringEnabled {false};   // Process: the meter adds a lot to processBlock's cost
+    juce::MemoryBlock state;        // SetState, left empty for events that pass through the FIFO
+};
+
+class CallbackTrace  : private juce::Thread
+{
+public:
+    // Never overwrites an existing file: if one is already there, a numbered
+    // sibling is used instead; getFile() says which.
+    explicit CallbackTrace (const juce::File& file);
+    ~CallbackTrace() override;
+    
+    // Returns a recorder if SIMPLEEQ_TRACE_FILE is set and the trace file
+    // could be opened, otherwise nullptr. Logs the path actually used.
+    static std::unique_ptr<CallbackTrace> createFromEnvironment();
+    
+    const juce::File& getFile() const { return output.getFile(); }
+    bool isRecording() const { return output.openedOk(); }
+    
+    // Message thread
+    void recordPrepare (double sampleRate, int samplesPerBlock, juce::int64 startTicks);
+    void recordSetState (const void* data, int sizeInBytes, juce::int64 startTicks);
+    
+    // Audio thread: never locks or allocates. Events are dropped (and
+    // counted) if the writer thread falls behind.
+    void recordProcess (int numSamples, bool nonRealtime, const ChainSettings& settings,
+                        bool meteringEnabled, juce::int64 startTicks) noexcept;
+    
+    // Times a processBlock call and records it when the scope ends, so early
+    // returns are covered too. Takes every parameter that changes what
+    // processBlock does, so a replay takes the same path.
+    struct ScopedProcess
+    {
+        ScopedProcess (CallbackTrace& traceToUse, int blockSize, bool isNonRealtime,
+                       const ChainSettings& chainSettings, bool isMeteringEnabled) noexcept
+            : trace (traceToUse), numSamples (blockSize), nonRealtime (isNonRealtime),
+              settings (chainSettings), meteringEnabled (isMeteringEnabled) {}
+        
+        ~ScopedProcess() { trace.recordProcess (numSamples, nonRealtime, settings, meteringEnabled, startTicks); }
+        
+        CallbackTrace& trace;
+        int numSamples;
+        bool nonRealtime;
+        ChainSettings settings;
+        bool meteringEnabled;
+        juce::int64 startTicks {juce::Time::getHighResolutionTicks()};
+        
+        JUCE_DECLARE_NON_COPYABLE (ScopedProcess)
+    };
+    
+    // Returns the events in the order they happened, plus the number of
+    // process events the recorder had to drop.
+    static juce::Result read (const juce::File& file, std::vector<CallbackEvent>& events,
+                              juce::int64& ticksPerSecond, int& droppedEvents);
+    
+private:
+    void run() override;
+    void writePending();
+    
+    static constexpr int fifoSize = 1 << 14;
+    
+    juce::FileOutputStream output;
+    
+    std::atomic<juce::uint32> nextSequence {0};
+    std::atomic<int> droppedEvents {0};
+    
+    juce::AbstractFifo processFifo {fifoSize};
+    std::vector<CallbackEvent> processEvents;
+    
+    juce::CriticalSection messageLock;
+    std::vector<CallbackEvent> messageEvents;
+    
+    // Writer thread only
+    std::vector<CallbackEvent> batch;
+    int totalDroppedEvents {0};
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CallbackTrace)
+};
@@ -0,0 +1,226 @@
+/*
+  ==============================================================================
+
+    Output metering that runs on the filtered samples straight after each
+    chunk is written, so the data is still in cache and no second plugin
+    pass is needed.
+
+  ==============================================================================
+*/
+
+#include "OutputMeter.h"
+
+namespace
+{
+    float toDecibels (double gain)
+    {
+        return juce::Decibels::gainToDecibels ((float) gain, OutputMeter::silenceLevel);
+    }
+
+    float toLoudness (double meanSquare)
+    {
+        if (meanSquare <= 0.0)
+            return OutputMeter::silenceLevel;
+
+        return juce::jmax (OutputMeter::silenceLevel, (float) (-0.691 + 10.0 * std::log10 (meanSquare)));
+    }
+}
+
+OutputMeter::OutputMeter()
+{
+    // Blackman windowed sinc with its cutoff at the original Nyquist frequency,
+    // split into one short filter per interpolated phase.
+    constexpr int numTaps = oversamplingFactor * tapsPerPhase;
+    const auto centre = (numTaps - 1) * 0.5;
+
+    for (int n = 0; n < numTaps; ++n)
+    {
+        const auto x = (n - centre) / oversamplingFactor;
+        const auto sinc = x == 0.0 ? 1.0 : std::sin (juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+        const auto phase = juce::MathConstants<double>::twoPi * n / (numTaps - 1);
+        const auto window = 0.42 - 0.5 * std::cos (phase) + 0.08 * std::cos (2.0 * phase);
+
+        interpolatorPhases[(size_t) (n % oversamplingFactor)][(size_t) (n / oversamplingFactor)] = (float) (sinc * window);
+    }
+}
+
+void OutputMeter::prepare (double sampleRate)
+{
+    // K-weighting filters from ITU-R BS.1770, with the analogue prototypes
+    // re-derived for the current sample rate.
+    {
+        const auto k = std::tan (juce::MathConstants<double>::pi * 1681.974450955533 / sampleRate);
+        const auto q = 0.7071752369554196;
+        const auto vh = std::pow (10.0, 3.999843853973347 / 20.0);
+        const auto vb = std::pow (vh, 0.4996667741545416);
+        const auto a0 = 1.0 + k / q + k * k;
+
+        for (auto& stage : shelfStages)
+        {
+            stage.b0 = (vh + vb * k / q + k * k) / a0;
+            stage.b1 = 2.0 * (k * k - vh) / a0;
+            stage.b2 = (vh - vb * k / q + k * k) / a0;
+            stage.a1 = 2.0 * (k * k - 1.0) / a0;
+            stage.a2 = (1.0 - k / q + k * k) / a0;
+        }
+    }
+
+    {
+        const auto k = std::tan (juce::MathConstants<double>::pi * 38.13547087602444 / sampleRate);
+        const auto q = 0.5003270373238773;
+        const auto a0 = 1.0 + k / q + k * k;
+
+        for (auto& stage : highPassStages)
+        {
+            stage.b0 = 1.0;
+            stage.b1 = -2.0;
+            stage.b2 = 1.0;
+            stage.a1 = 2.0 * (k * k - 1.0) / a0;
+            stage.a2 = (1.0 - k / q + k * k) / a0;
+        }
+    }
+
+    subBlockLength = juce::jmax (1, juce::roundToInt (sampleRate * 0.1));
+
+    for (auto& detector : truePeakDetectors)
+        detector.prepare (subBlockLength);
+
+    reset();
+}
+
+void OutputMeter::reset() noexcept
+{
+    for (auto* stages : { &shelfStages, &highPassStages })
+    {
+        for (auto& stage : *stages)
+            stage.s1 = stage.s2 = 0.0;
+    }
+
+    for (auto& detector : truePeakDetectors)
+        detector.reset();
+
+    subBlockPosition = 0;
+    weightedEnergy = energy = 0.0;
+    subBlockPeak = subBlockTruePeak = 0.f;
+
+    weightedHistory.fill (0.0);
+    energyHistory.fill (0.0);
+    historyPosition = historySize = 0;
+
+    for (auto* reading : { &samplePeak, &truePeak, &rms, &momentaryLoudness, &shortTermLoudness })
+        reading->store (silenceLevel, std::memory_order_relaxed);
+}
+
+void OutputMeter::TruePeakDetector::prepare (int maxChunkSize)
+{
+    input.assign ((size_t) (maxChunkSize + tapsPerPhase - 1), 0.f);
+    interpolated.assign ((size_t) maxChunkSize, 0.f);
+}
+
+void OutputMeter::TruePeakDetector::reset() noexcept
+{
+    std::fill (input.begin(), input.end(), 0.f);
+}
+
+float OutputMeter::TruePeakDetector::process (const float* samples, int numSamples, const InterpolatorPhases& phases) noexcept
+{
+    constexpr int historyLength = tapsPerPhase - 1;
+    jassert ((size_t) numSamples <= interpolated.size());
+
+    auto* x = input.data();
+    auto* y = interpolated.data();
+    std::copy (samples, samples + numSamples, x + historyLength);
+
+    auto peak = 0.f;
+
+    for (const auto& phase : phases)
+    {
+        std::fill (y, y + numSamples, 0.f);
+
+        for (int tap = 0; tap < tapsPerPhase; ++tap)
+        {
+            const auto coefficient = phase[(size_t) tap];
+            const auto* delayed = x + historyLength - tap;
+
+            for (int i = 0; i < numSamples; ++i)
+                y[i] += coefficient * delayed[i];
+        }
+
+        auto range = juce::FloatVectorOperations::findMinAndMax (y, numSamples);
+        peak = juce::jmax (peak, -range.getStart(), range.getEnd());
+    }
+
+    std::copy (x + numSamples, x + numSamples + historyLength, x);
+
+    return peak;
+}
+
+void OutputMeter::process (const float* left, const float* right, int numSamples) noexcept
+{
+    const float* channels[] { left, right };
+    int done = 0;
+
+    while (done < numSamples)
+    {
+        const auto count = juce::jmin (numSamples - done, subBlockLength - subBlockPosition);
+
+        for (size_t channel = 0; channel < 2; ++channel)
+        {
+            const auto* samples = channels[channel] + done;
+            auto& shelf = shelfStages[channel];
+            auto& highPass = highPassStages[channel];
+
+            // Only the K-weighting filters are recursive; the peaks are
+            // found with block operations over the whole chunk.
+            for (int i = 0; i < count; ++i)
+            {
+                const auto sample = samples[i];
+                const auto weighted = highPass.processSample (shelf.processSample (sample));
+
+                energy += (double) sample * sample;
+                weightedEnergy += weighted * weighted;
+            }
+
+            subBlockPeak = juce::jmax (subBlockPeak, juce::FloatVectorOperations::findMaximum (samples, count),
+                                       -juce::FloatVectorOperations::findMinimum (samples, count));
+            subBlockTruePeak = juce::jmax (subBlockTruePeak, truePeakDetectors[channel].process (samples, count, interpolatorPhases));
+        }
+
+        done += count;
+        subBlockPosition += count;
+
+        if (subBlockPosition == subBlockLength)
+            publishSubBlock();
+    }
+}
+
+void OutputMeter::publishSubBlock() noexcept
+{
+    weightedHistory[(size_t) historyPosition] = weightedEnergy;
+    energyHistory[(size_t) historyPosition] = energy;
+    historyPosition = (historyPosition + 1) % numSubBlocks;
+    historySize = juce::jmin (historySize + 1, numSubBlocks);
+
+    auto sumRecent = [this] (const std::array<double, numSubBlocks>& history, int count)
+    {
+        count = juce::jmin (count, historySize);
+        auto sum = 0.0;
+
+        for (int i = 1; i <= count; ++i)
+            sum += history[(size_t) ((historyPosition - i + numSubBlocks) % numSubBlocks)];
+
+        return sum / (double (count) * subBlockLength);
+    };
+
+    // Loudness sums the channels' mean squares (unity channel weights);
+    // RMS averages them.
+    momentaryLoudness.store (toLoudness (sumRecent (weightedHistory, momentarySubBlocks)), std::memory_order_relaxed);
+    shortTermLoudness.store (toLoudness (sumRecent (weightedHistory, numSubBlocks)), std::memory_order_relaxed);
+    rms.store (toDecibels (std::sqrt (sumRecent (energyHistory, rmsSubBlocks) * 0.5)), std::memory_order_relaxed);
+    samplePeak.store (toDecibels (subBlockPeak), std::memory_order_relaxed);
+    truePeak.store (toDecibels (juce::jmax (subBlockPeak, subBlockTruePeak)), std::memory_order_relaxed);
+
+    subBlockPosition = 0;
+    weightedEnergy = energy = 0.0;
+    subBlockPeak = subBlockTruePeak = 0.f;
+}
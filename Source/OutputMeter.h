@@ -0,0 +1,92 @@
+/*
+  ==============================================================================
+
+    Output metering that runs on the filtered samples straight after each
+    chunk is written, so the data is still in cache and no second plugin
+    pass is needed.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+class OutputMeter
+{
+public:
+    OutputMeter();
+
+    void prepare (double sampleRate);
+    void reset() noexcept;
+
+    // Measures a chunk of stereo output. Readings are published every 100 ms.
+    void process (const float* left, const float* right, int numSamples) noexcept;
+
+    // All readings are in dB (dBFS, dBTP or LUFS), floored at silenceLevel.
+    float getSamplePeak() const noexcept        { return samplePeak.load (std::memory_order_relaxed); }
+    float getTruePeak() const noexcept          { return truePeak.load (std::memory_order_relaxed); }
+    float getRms() const noexcept               { return rms.load (std::memory_order_relaxed); }
+    float getMomentaryLoudness() const noexcept { return momentaryLoudness.load (std::memory_order_relaxed); }
+    float getShortTermLoudness() const noexcept { return shortTermLoudness.load (std::memory_order_relaxed); }
+
+    static constexpr float silenceLevel = -100.f;
+
+private:
+    struct Biquad
+    {
+        double b0 {1}, b1 {0}, b2 {0}, a1 {0}, a2 {0};
+        double s1 {0}, s2 {0};
+
+        double processSample (double input) noexcept
+        {
+            const auto output = b0 * input + s1;
+            s1 = b1 * input - a1 * output + s2;
+            s2 = b2 * input - a2 * output;
+            return output;
+        }
+    };
+
+    // 4x polyphase interpolator used for the true-peak estimate.
+    static constexpr int oversamplingFactor = 4;
+    static constexpr int tapsPerPhase = 12;
+
+    using InterpolatorPhases = std::array<std::array<float, tapsPerPhase>, oversamplingFactor>;
+
+    // Runs each interpolation phase as a block FIR over a whole chunk, with
+    // the taps in the outer loop so the inner loop over samples vectorises.
+    struct TruePeakDetector
+    {
+        // The last tapsPerPhase - 1 samples of the previous chunk, followed
+        // by the current one. Both buffers are sized in prepare().
+        std::vector<float> input, interpolated;
+
+        void prepare (int maxChunkSize);
+        void reset() noexcept;
+        float process (const float* samples, int numSamples, const InterpolatorPhases& phases) noexcept;
+    };
+
+    // BS.1770 gating windows are built from 100 ms sub-blocks:
+    // 4 for momentary, 30 for short-term loudness and 3 for RMS.
+    static constexpr int numSubBlocks = 30;
+    static constexpr int momentarySubBlocks = 4;
+    static constexpr int rmsSubBlocks = 3;
+
+    void publishSubBlock() noexcept;
+
+    InterpolatorPhases interpolatorPhases;
+
+    std::array<Biquad, 2> shelfStages, highPassStages;
+    std::array<TruePeakDetector, 2> truePeakDetectors;
+
+    int subBlockLength {4800};
+    int subBlockPosition {0};
+    double weightedEnergy {0}, energy {0};
+    float subBlockPeak {0}, subBlockTruePeak {0};
+
+    std::array<double, numSubBlocks> weightedHistory {}, energyHistory {};
+    int historyPosition {0}, historySize {0};
+
+    std::atomic<float> samplePeak {silenceLevel}, truePeak {silenceLevel}, rms {silenceLevel},
+                       momentaryLoudness {silenceLevel}, shortTermLoudness {silenceLevel};
+};
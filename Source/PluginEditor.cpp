@@ -9,45 +9,332 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
-ResponseCurveComponent::ResponseCurveComponent (SimpleEqualizerAudioProcessor& p) : audioProcessor (p)
+using SectionCoefficients = juce::dsp::IIR::Coefficients<float>;
+
+struct ResponseCurveComponent::CurveRenderer
 {
-    const auto& params = audioProcessor.getParameters();
-    for (auto param : params)
+    struct Snapshot
+    {
+        std::vector<SectionCoefficients> sections;
+        double sampleRate {0};
+        int width {0}, height {0};
+        float scale {1.f};
+    };
+    
+    juce::CriticalSection lock;
+    std::optional<Snapshot> pending;
+    bool rendering {false};
+    juce::Image image;
+    
+    static juce::Image render (const Snapshot& snapshot)
+    {
+        using namespace juce;
+        
+        Image curveImage (Image::ARGB,
+                          jmax (1, roundToInt (snapshot.width * snapshot.scale)),
+                          jmax (1, roundToInt (snapshot.height * snapshot.scale)),
+                          true, SoftwareImageType());
+        
+        Graphics g (curveImage);
+        g.addTransform (AffineTransform::scale (snapshot.scale));
+        
+        Rectangle<int> responseArea (snapshot.width, snapshot.height);
+        auto w = responseArea.getWidth();
+        
+        std::vector<double> mags;
+        mags.resize (w);
+        
+        for (int i = 0; i < w; ++i)
+        {
+            double mag = 1.f;
+            auto freq = mapToLog10 (double (i) / double (w), 20.0, 20000.0);
+            
+            if (snapshot.sampleRate > 0)
+            {
+                for (const auto& section : snapshot.sections)
+                    mag *= section.getMagnitudeForFrequency (freq, snapshot.sampleRate);
+            }
+            
+            mags[i] = Decibels::gainToDecibels (mag);
+        }
+        
+        Path responseCurve;
+        
+        const double outputMin = responseArea.getBottom();
+        const double outputMax = responseArea.getY();
+        auto map = [outputMin, outputMax] (double input)
+        {
+            return jmap (input, -24.0, 24.0, outputMin, outputMax);
+        };
+        
+        responseCurve.startNewSubPath (responseArea.getX(), map (mags.front()));
+        
+        for (size_t i = 1; i < mags.size(); ++i)
+        {
+            responseCurve.lineTo (responseArea.getX() + i, map (mags[i]));
+        }
+        
+        g.setColour (Colours::orange);
+        g.drawRoundedRectangle (responseArea.toFloat(), 4.f, 1.f);
+        
+        g.setColour (Colours::white);
+        g.strokePath (responseCurve, PathStrokeType (2.f));
+        
+        return curveImage;
+    }
+};
+
+static void addPassFilterSections (std::vector<SectionCoefficients>& sections, const PassFilter& passFilter)
+{
+    if (! passFilter.isBypassed<0>())
+        sections.push_back (*passFilter.get<0>().coefficients);
+    if (! passFilter.isBypassed<1>())
+        sections.push_back (*passFilter.get<1>().coefficients);
+    if (! passFilter.isBypassed<2>())
+        sections.push_back (*passFilter.get<2>().coefficients);
+    if (! passFilter.isBypassed<3>())
+        sections.push_back (*passFilter.get<3>().coefficients);
+    if (! passFilter.isBypassed<4>())
+        sections.push_back (*passFilter.get<4>().coefficients);
+    if (! passFilter.isBypassed<5>())
+        sections.push_back (*passFilter.get<5>().coefficients);
+}
+
+ResponseCurveComponent::ResponseCurveComponent (SimpleEqualizerAudioProcessor& p)
+    : audioProcessor (p),
+      renderer (std::make_shared<CurveRenderer>())
+{
+    const std::pair<const char*, int> bandParameterIDs[]
+    {
+        { "HighPass Freq", HighPassBand },
+        { "HighPass Slope", HighPassBand },
+        { "Peak Freq", PeakBand },
+        { "Peak Gain", PeakBand },
+        { "Peak Quality", PeakBand },
+        { "LowPass Freq", LowPassBand },
+        { "LowPass Slope", LowPassBand }
+    };
+    
+    parameterBands.resize ((size_t) audioProcessor.getParameters().size(), 0);
+    
+    for (const auto& [parameterID, band] : bandParameterIDs)
     {
+        auto* param = audioProcessor.apvts.getParameter (parameterID);
+        parameterBands[(size_t) param->getParameterIndex()] = band;
         param -> addListener(this);
     }
     
-    startTimerHz(60);
+    setOpaque (true);
 }
 
 ResponseCurveComponent::~ResponseCurveComponent()
 {
-    const auto& params = audioProcessor.getParameters();
-    for (auto param : params)
+    for (auto* param : audioProcessor.getParameters())
     {
-        param -> removeListener(this);
+        if (parameterBands[(size_t) param->getParameterIndex()] != 0)
+            param -> removeListener(this);
     }
 }
 
 void ResponseCurveComponent::parameterValueChanged (int parameterIndex, float newValue)
 {
-    parametersChanged.set (true);
+    // May be called from any thread, including the audio thread during
+    // automation, so this only records which band changed. Posting a message
+    // from there could block; the idle poll picks those changes up instead.
+    changedBands.fetch_or (parameterBands[(size_t) parameterIndex]);
+    
+    if (juce::MessageManager::existsAndIsCurrentThread())
+        wake();
+}
+
+bool ResponseCurveComponent::hasPendingWork() const
+{
+    // Band changes can't be designed until the processor has a sample rate.
+    const auto bandsToDesign = changedBands.load() != 0 && audioProcessor.getSampleRate() > 0;
+    return bandsToDesign || renderNeeded || repaintPending;
+}
+
+// Message thread only: attaches to the vblank while there's work to do.
+void ResponseCurveComponent::wake()
+{
+    if (! isShowing())
+        return;
+    
+    stopTimer();
+    
+    if (vBlankAttachment == nullptr)
+        vBlankAttachment = std::make_unique<juce::VBlankAttachment> (this, [this] { onVBlank(); });
+}
+
+void ResponseCurveComponent::showingChanged()
+{
+    if (isShowing())
+    {
+        renderNeeded = true;
+        wake();
+        return;
+    }
+    
+    // Hidden editors defer all work until they're shown again: changes keep
+    // accumulating in changedBands.
+    vBlankAttachment.reset();
+    stopTimer();
 }
 
 void ResponseCurveComponent::timerCallback()
 {
-    if (parametersChanged.compareAndSetBool (false, true))
+    // The vblank attachment can't be deleted from inside its own callback,
+    // so an idle frame hands over to this timer, which detaches it here.
+    vBlankAttachment.reset();
+    
+    // A minimised window isn't showing but gets no visibility callback when
+    // it's restored, so keep polling; truly hidden editors are woken by the
+    // visibility watcher instead.
+    if (! isShowing())
     {
-        auto chainSettings = getChainSettings (audioProcessor.apvts);
-        auto peakCoefficients = makePeakFilter (chainSettings, audioProcessor.getSampleRate());
-        updateCoefficients (monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+        auto* peer = getPeer();
         
-        auto highPassCoefficients = makeHighPassFilter (chainSettings, audioProcessor.getSampleRate());
-        auto lowPassCoefficients = makeLowPassFilter (chainSettings, audioProcessor.getSampleRate());
+        if (peer == nullptr || ! peer->isMinimised())
+            stopTimer();
         
+        return;
+    }
+    
+    if (hasPendingWork())
+        wake();
+}
+
+bool ResponseCurveComponent::redesignBands (int bands)
+{
+    auto sampleRate = audioProcessor.getSampleRate();
+    
+    // Nothing can be designed until the host has prepared the processor.
+    if (sampleRate <= 0)
+    {
+        changedBands.fetch_or (bands);
+        return false;
+    }
+    
+    auto chainSettings = getChainSettings (audioProcessor.apvts);
+    
+    if (bands & HighPassBand)
+    {
+        auto highPassCoefficients = makeHighPassFilter (chainSettings, sampleRate);
         updatePassFilter (monoChain.get<ChainPositions::HighPass>(), highPassCoefficients, chainSettings.highPassSlope);
+    }
+    
+    if (bands & PeakBand)
+    {
+        auto peakCoefficients = makePeakFilter (chainSettings, sampleRate);
+        updateCoefficients (monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    }
+    
+    if (bands & LowPassBand)
+    {
+        auto lowPassCoefficients = makeLowPassFilter (chainSettings, sampleRate);
         updatePassFilter (monoChain.get<ChainPositions::LowPass>(), lowPassCoefficients, chainSettings.lowPassSlope);
+    }
+    
+    return true;
+}
+
+void ResponseCurveComponent::requestRender()
+{
+    if (getWidth() <= 0 || getHeight() <= 0)
+        return;
+    
+    CurveRenderer::Snapshot snapshot;
+    snapshot.sampleRate = audioProcessor.getSampleRate();
+    snapshot.width = getWidth();
+    snapshot.height = getHeight();
+    snapshot.scale = (float) juce::Component::getApproximateScaleFactorForComponent (this);
+    
+    addPassFilterSections (snapshot.sections, monoChain.get<ChainPositions::HighPass>());
+    
+    if (! monoChain.isBypassed<ChainPositions::Peak>())
+        snapshot.sections.push_back (*monoChain.get<ChainPositions::Peak>().coefficients);
+    
+    addPassFilterSections (snapshot.sections, monoChain.get<ChainPositions::LowPass>());
+    
+    const juce::ScopedLock sl (renderer->lock);
+    renderer->pending = std::move (snapshot);
+    
+    // A job that's already running picks up the newest snapshot when it
+    // finishes, so bursts of changes only cost one extra render.
+    if (renderer->rendering)
+        return;
+    
+    renderer->rendering = true;
+    
+    renderPool->addJob ([curveRenderer = renderer, safeThis = SafePointer<ResponseCurveComponent> (this)]
+    {
+        for (;;)
+        {
+            CurveRenderer::Snapshot next;
+            
+            {
+                const juce::ScopedLock sl (curveRenderer->lock);
+                
+                if (! curveRenderer->pending.has_value())
+                {
+                    curveRenderer->rendering = false;
+                    return;
+                }
+                
+                next = std::move (*curveRenderer->pending);
+                curveRenderer->pending.reset();
+            }
+            
+            auto rendered = CurveRenderer::render (next);
+            
+            {
+                const juce::ScopedLock sl (curveRenderer->lock);
+                curveRenderer->image = rendered;
+            }
+            
+            juce::MessageManager::callAsync ([safeThis]
+            {
+                if (auto* component = safeThis.getComponent())
+                    component->curveRendered();
+            });
+        }
+    });
+}
+
+void ResponseCurveComponent::curveRendered()
+{
+    repaintPending = true;
+    wake();
+}
+
+void ResponseCurveComponent::onVBlank()
+{
+    if (! isShowing() || ! hasPendingWork())
+    {
+        // Either an ancestor was hidden or minimised, or nothing changed
+        // since the last frame. Fall back to the slow poll, which also
+        // detaches this callback.
+        if (! isTimerRunning())
+            startTimer (idlePollIntervalMs);
         
+        return;
+    }
+    
+    stopTimer();
+    
+    if (auto bands = changedBands.exchange (0))
+        if (redesignBands (bands))
+            renderNeeded = true;
+    
+    if (renderNeeded)
+    {
+        renderNeeded = false;
+        requestRender();
+    }
+    
+    if (repaintPending)
+    {
+        repaintPending = false;
         repaint();
     }
 }
@@ -58,90 +345,100 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (Colours::black);
     
-    auto responseArea = getLocalBounds();
-    auto w = responseArea.getWidth();
-    
-    auto& highpass = monoChain.get<ChainPositions::HighPass>();
-    auto& lowpass = monoChain.get<ChainPositions::LowPass>();
-    auto& peak = monoChain.get<ChainPositions::Peak>();
+    Image curveImage;
     
-    auto sampleRate = audioProcessor.getSampleRate();
+    {
+        const ScopedLock sl (renderer->lock);
+        curveImage = renderer->image;
+    }
     
-    std::vector<double> mags;
-    mags.resize(w);
+    if (curveImage.isValid())
+        g.drawImage (curveImage, getLocalBounds().toFloat());
+}
+
+void ResponseCurveComponent::resized()
+{
+    renderNeeded = true;
+    wake();
+}
+
+OutputMeterComponent::OutputMeterComponent (const OutputMeter& meter) : outputMeter (meter)
+{
+}
+
+void OutputMeterComponent::timerCallback()
+{
+    repaint();
+}
+
+void OutputMeterComponent::visibilityChanged()
+{
+    // The meter publishes new readings every 100 ms; there's no point polling
+    // while nobody can see them.
+    if (isShowing())
+        startTimerHz (10);
+    else
+        stopTimer();
+}
+
+void OutputMeterComponent::parentHierarchyChanged()
+{
+    visibilityChanged();
+}
+
+void OutputMeterComponent::paint (juce::Graphics& g)
+{
+    using namespace juce;
+    g.fillAll (Colours::black);
     
-    for (int i = 0; i < w; ++i)
+    auto format = [] (float value, const String& unit)
     {
-        double mag = 1.f;
-        auto freq = mapToLog10 (double (i) / double (w), 20.0, 20000.0);
+        if (value <= OutputMeter::silenceLevel)
+            return "-inf " + unit;
         
-        if (! monoChain.isBypassed<ChainPositions::Peak>())
-        {
-            mag *= peak.coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        }
-        if (!highpass.isBypassed<0>())
-            mag *= highpass.get<0>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (!highpass.isBypassed<1>())
-            mag *= highpass.get<1>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (!highpass.isBypassed<2>())
-            mag *= highpass.get<2>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (!highpass.isBypassed<3>())
-            mag *= highpass.get<3>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (!highpass.isBypassed<4>())
-            mag *= highpass.get<4>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! highpass.isBypassed<5>())
-            mag *= highpass.get<5>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        
-        if (! lowpass.isBypassed<0>())
-            mag *= lowpass.get<0>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! lowpass.isBypassed<0>())
-            mag *= lowpass.get<0>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! lowpass.isBypassed<0>())
-            mag *= lowpass.get<0>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! lowpass.isBypassed<0>())
-            mag *= lowpass.get<0>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! lowpass.isBypassed<0>())
-            mag *= lowpass.get<0>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        if (! lowpass.isBypassed<0>())
-            mag *= lowpass.get<0>().coefficients->getMagnitudeForFrequency (freq, sampleRate);
-        
-        mags[i] = Decibels::gainToDecibels  (mag);
-    }
-    
-    Path responseCurve;
+        return String (value, 1) + " " + unit;
+    };
     
-    const double outputMin = responseArea.getBottom();
-    const double outputMax = responseArea.getY();
-    auto map = [outputMin, outputMax] (double input)
+    const std::pair<String, String> readings[]
     {
-        return jmap (input, -24.0, 24.0, outputMin, outputMax);
+        { "Peak", format (outputMeter.getSamplePeak(), "dBFS") },
+        { "True Peak", format (outputMeter.getTruePeak(), "dBTP") },
+        { "RMS", format (outputMeter.getRms(), "dBFS") },
+        { "Momentary", format (outputMeter.getMomentaryLoudness(), "LUFS") },
+        { "Short-term", format (outputMeter.getShortTermLoudness(), "LUFS") }
     };
     
-    responseCurve.startNewSubPath (responseArea.getX(), map(mags.front()));
+    auto bounds = getLocalBounds().reduced (6);
+    auto rowHeight = bounds.getHeight() / (int) std::size (readings);
     
-    for (size_t i = 1; i < mags.size(); ++i)
+    g.setFont (13.f);
+    
+    for (const auto& [label, value] : readings)
     {
-        responseCurve.lineTo (responseArea.getX() + i, map (mags[i]));
+        auto row = bounds.removeFromTop (rowHeight);
+        g.setColour (Colours::grey);
+        g.drawText (label, row, Justification::centredLeft);
+        g.setColour (Colours::white);
+        g.drawText (value, row, Justification::centredRight);
     }
     
     g.setColour (Colours::orange);
-    g.drawRoundedRectangle (responseArea.toFloat(), 4.f, 1.f);
-    
-    g.setColour (Colours::white);
-    g.strokePath (responseCurve, PathStrokeType(2.f));
+    g.drawRoundedRectangle (getLocalBounds().toFloat(), 4.f, 1.f);
 }
 
 //==============================================================================
 SimpleEqualizerAudioProcessorEditor::SimpleEqualizerAudioProcessorEditor (SimpleEqualizerAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p),
 responseCurveComponent(audioProcessor),
+outputMeterComponent (audioProcessor.getOutputMeter()),
 highPassFreqSliderAttachment (audioProcessor.apvts, "HighPass Freq", highPassFreqSlider),
 highPassSlopeSliderAttachment (audioProcessor.apvts, "HighPass Slope", highPassSlopeSlider),
 lowPassFreqSliderAttachment (audioProcessor.apvts, "LowPass Freq", lowPassFreqSlider),
 lowPassSlopeSliderAttachment (audioProcessor.apvts, "LowPass Slope", lowPassSlopeSlider),
 peakFreqSliderAttachment (audioProcessor.apvts, "Peak Freq", peakFreqSlider),
 peakGainSliderAttachment (audioProcessor.apvts, "Peak Gain", peakGainSlider),
-peakQualitySliderAttachment (audioProcessor.apvts, "Peak Quality", peakQualitySlider)
+peakQualitySliderAttachment (audioProcessor.apvts, "Peak Quality", peakQualitySlider),
+meteringEnabledButtonAttachment (audioProcessor.apvts, "Metering Enabled", meteringEnabledButton)
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
@@ -172,6 +469,9 @@ void SimpleEqualizerAudioProcessorEditor::resized()
     auto bounds = getLocalBounds();
     
     auto responseArea = bounds.removeFromTop (bounds.getHeight() * 0.33);
+    auto meterArea = responseArea.removeFromRight (160);
+    meteringEnabledButton.setBounds (meterArea.removeFromTop (24));
+    outputMeterComponent.setBounds (meterArea);
     responseCurveComponent.setBounds (responseArea);
     
     auto highPassArea = bounds.removeFromLeft (bounds.getWidth() * 0.33);
@@ -198,6 +498,8 @@ std::vector<juce::Component*> SimpleEqualizerAudioProcessorEditor::getComps()
         &peakQualitySlider,
         &highPassSlopeSlider,
         &lowPassSlopeSlider,
-        &responseCurveComponent
+        &responseCurveComponent,
+        &outputMeterComponent,
+        &meteringEnabledButton
     };
 }
@@ -20,12 +20,18 @@ struct CustomRotarySlider : juce::Slider
     }
 };
 
+// Redraws only in response to parameter changes: the changed bands are
+// picked up and redesigned on the message thread at the next vblank, the
+// curve is rasterised on a shared background thread, and the finished image
+// is repainted on a later vblank. Once a frame passes with nothing to do the
+// vblank is detached; only a slow poll for automation that arrives on the
+// audio thread keeps running, and nothing runs while the editor is hidden.
 struct ResponseCurveComponent: juce::Component,
                                juce::AudioProcessorParameter::Listener,
                                juce::Timer
 {
     ResponseCurveComponent (SimpleEqualizerAudioProcessor&);
-    ~ResponseCurveComponent();
+    ~ResponseCurveComponent() override;
     
     void parameterValueChanged (int parameterIndex, float newValue) override;
     void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override {}
@@ -33,13 +39,85 @@ struct ResponseCurveComponent: juce::Component,
     void timerCallback() override;
     
     void paint (juce::Graphics& g) override;
+    void resized() override;
     
 private:
+    enum Band
+    {
+        HighPassBand = 1,
+        PeakBand = 2,
+        LowPassBand = 4,
+        AllBands = HighPassBand | PeakBand | LowPassBand
+    };
+    
+    struct CurveRenderer;
+    
+    // Reports visibility changes of the component and of every ancestor,
+    // which Component::visibilityChanged doesn't.
+    struct VisibilityWatcher : juce::ComponentMovementWatcher
+    {
+        explicit VisibilityWatcher (ResponseCurveComponent& c) : juce::ComponentMovementWatcher (&c), owner (c) {}
+        
+        using juce::ComponentMovementWatcher::componentMovedOrResized;
+        using juce::ComponentMovementWatcher::componentVisibilityChanged;
+        
+        void componentMovedOrResized (bool, bool) override {}
+        void componentPeerChanged() override { owner.showingChanged(); }
+        void componentVisibilityChanged() override { owner.showingChanged(); }
+        
+        ResponseCurveComponent& owner;
+    };
+    
+    // How often the idle poll looks for automation from the audio thread.
+    static constexpr int idlePollIntervalMs = 100;
+    
+    // One worker thread shared by every open editor.
+    struct RenderPool : juce::ThreadPool
+    {
+        RenderPool() : juce::ThreadPool (1) {}
+    };
+    
     SimpleEqualizerAudioProcessor& audioProcessor;
     
-    juce::Atomic<bool> parametersChanged {false};
+    // Indexed by parameter index, 0 for parameters that don't shape the curve.
+    std::vector<int> parameterBands;
+    // Set from any thread, drained on the message thread.
+    std::atomic<int> changedBands {AllBands};
     
     MonoChain monoChain;
+    
+    juce::SharedResourcePointer<RenderPool> renderPool;
+    std::shared_ptr<CurveRenderer> renderer;
+    
+    // Only exists while there is work for the next frames.
+    std::unique_ptr<juce::VBlankAttachment> vBlankAttachment;
+    bool renderNeeded {true};
+    bool repaintPending {false};
+    
+    VisibilityWatcher visibilityWatcher {*this};
+    
+    bool hasPendingWork() const;
+    void wake();
+    void showingChanged();
+    bool redesignBands (int bands);
+    void requestRender();
+    void curveRendered();
+    void onVBlank();
+};
+
+struct OutputMeterComponent : juce::Component,
+                              juce::Timer
+{
+    OutputMeterComponent (const OutputMeter&);
+    
+    void timerCallback() override;
+    
+    void paint (juce::Graphics& g) override;
+    void visibilityChanged() override;
+    void parentHierarchyChanged() override;
+    
+private:
+    const OutputMeter& outputMeter;
 };
 
 //==============================================================================
@@ -64,12 +142,16 @@ private:
     CustomRotarySlider highPassFreqSlider, highPassSlopeSlider, lowPassFreqSlider, lowPassSlopeSlider, peakFreqSlider, peakGainSlider, peakQualitySlider;
     
     ResponseCurveComponent responseCurveComponent;
+    OutputMeterComponent outputMeterComponent;
+    juce::ToggleButton meteringEnabledButton {"Metering"};
     
     using APVTS = juce::AudioProcessorValueTreeState;
     using Attachment = APVTS::SliderAttachment;
     
     Attachment highPassFreqSliderAttachment, highPassSlopeSliderAttachment, lowPassFreqSliderAttachment, lowPassSlopeSliderAttachment,peakFreqSliderAttachment, peakGainSliderAttachment, peakQualitySliderAttachment;
     
+    APVTS::ButtonAttachment meteringEnabledButtonAttachment;
+    
     std::vector<juce::Component*> getComps();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimpleEqualizerAudioProcessorEditor)
@@ -8,6 +8,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "CallbackTrace.h"
 
 //==============================================================================
 SimpleEqualizerAudioProcessor::SimpleEqualizerAudioProcessor()
@@ -22,6 +23,7 @@ SimpleEqualizerAudioProcessor::SimpleEqualizerAudioProcessor()
                        )
 #endif
 {
+    callbackTrace = CallbackTrace::createFromEnvironment();
 }
 
 SimpleEqualizerAudioProcessor::~SimpleEqualizerAudioProcessor()
@@ -95,6 +97,8 @@ void SimpleEqualizerAudioProcessor::prepareToPlay (double sampleRate, int sample
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    
     juce::dsp::ProcessSpec spec;
     spec.maximumBlockSize = samplesPerBlock;
     spec.numChannels = 1;
@@ -103,7 +107,20 @@ void SimpleEqualizerAudioProcessor::prepareToPlay (double sampleRate, int sample
     leftChain.prepare (spec);
     rightChain.prepare (spec);
     
+    leftBlockChain.reset();
+    rightBlockChain.reset();
+    
+    renderingOffline = isNonRealtime();
+    renderBuffer.setSize (2, samplesPerBlock);
+    leftRenderChain.reset();
+    rightRenderChain.reset();
+    
+    outputMeter.prepare (sampleRate);
+    
     updateFilters();
+    
+    if (callbackTrace != nullptr)
+        callbackTrace->recordPrepare (sampleRate, samplesPerBlock, startTicks);
 }
 
 void SimpleEqualizerAudioProcessor::releaseResources()
@@ -141,6 +158,13 @@ bool SimpleEqualizerAudioProcessor::isBusesLayoutSupported (const BusesLayout& l
 void SimpleEqualizerAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    
+    std::optional<CallbackTrace::ScopedProcess> traceScope;
+    
+    if (callbackTrace != nullptr)
+        traceScope.emplace (*callbackTrace, buffer.getNumSamples(), isNonRealtime(), getChainSettings (apvts),
+                            apvts.getRawParameterValue ("Metering Enabled") -> load() > 0.5f);
+    
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -156,17 +180,34 @@ void SimpleEqualizerAudioProcessor::processBlock (juce::AudioBuffer<float>& buff
     }
     
     updateFilters();
+    updateMetering();
+    
+    if (isNonRealtime())
+    {
+        if (! renderingOffline)
+            enterRenderMode();
+        
+        processOffline (buffer);
+        return;
+    }
     
-    juce::dsp::AudioBlock<float> block (buffer);
+    if (renderingOffline)
+        leaveRenderMode();
     
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    mirrorChain (leftBlockChain, leftChain);
+    mirrorChain (rightBlockChain, rightChain);
     
-    juce::dsp::ProcessContextReplacing<float> leftContext (leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext (rightBlock);
+    // Filter and measure in cache sized chunks so the meter reads samples
+    // the filters have only just written.
+    constexpr int chunkSize = 1024;
     
-    leftChain.process (leftContext);
-    rightChain.process (rightContext);
+    for (int start = 0; start < buffer.getNumSamples(); start += chunkSize)
+    {
+        const auto numSamples = juce::jmin (chunkSize, buffer.getNumSamples() - start);
+        leftBlockChain.process (buffer.getWritePointer (0, start), numSamples);
+        rightBlockChain.process (buffer.getWritePointer (1, start), numSamples);
+        measureOutput (buffer, start, numSamples);
+    }
 
     // This is the place where you'd normally do the guts of your plugin's
     // audio processing...
@@ -208,12 +249,17 @@ void SimpleEqualizerAudioProcessor::setStateInformation (const void* data, int s
 {
     // You should use this method to restore your parameters from this memory block,
     // whose contents will have been created by the getStateInformation() call.
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    
     auto tree = juce::ValueTree::readFromData (data, sizeInBytes);
     if (tree.isValid())
     {
         apvts.replaceState (tree);
         updateFilters();
     }
+    
+    if (callbackTrace != nullptr)
+        callbackTrace->recordSetState (data, sizeInBytes, startTicks);
 }
 
 ChainSettings getChainSettings (juce::AudioProcessorValueTreeState& apvts)
@@ -232,14 +278,6 @@ ChainSettings getChainSettings (juce::AudioProcessorValueTreeState& apvts)
     return settings;
 }
 
-Coefficients makePeakFilter (const ChainSettings& chainSettings, double sampleRate)
-{
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter (sampleRate,
-                                                                chainSettings.peakFreq,
-                                                                chainSettings.peakQuality,
-                                                                juce::Decibels::decibelsToGain (chainSettings.peakGainInDecibels));
-}
-
 void SimpleEqualizerAudioProcessor::updatePeakFilter (const ChainSettings &chainSettings)
 {
 
@@ -282,6 +320,73 @@ void SimpleEqualizerAudioProcessor::updateFilters()
     updatePeakFilter (chainSettings);
 }
 
+void SimpleEqualizerAudioProcessor::enterRenderMode()
+{
+    renderingOffline = true;
+    
+    leftRenderChain.copyStateFrom (leftBlockChain);
+    rightRenderChain.copyStateFrom (rightBlockChain);
+}
+
+void SimpleEqualizerAudioProcessor::leaveRenderMode()
+{
+    renderingOffline = false;
+    
+    leftBlockChain.copyStateFrom (leftRenderChain);
+    rightBlockChain.copyStateFrom (rightRenderChain);
+}
+
+void SimpleEqualizerAudioProcessor::processOffline (juce::AudioBuffer<float>& buffer)
+{
+    const auto chainSettings = getChainSettings (apvts);
+    designChain (leftRenderChain, chainSettings, getSampleRate());
+    designChain (rightRenderChain, chainSettings, getSampleRate());
+    
+    const auto chunkSize = renderBuffer.getNumSamples();
+    jassert (chunkSize > 0);
+    
+    for (int start = 0; start < buffer.getNumSamples(); start += chunkSize)
+    {
+        const auto numSamples = juce::jmin (chunkSize, buffer.getNumSamples() - start);
+        
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            auto* samples = buffer.getWritePointer (channel, start);
+            auto* renderSamples = renderBuffer.getWritePointer (channel);
+            
+            std::copy (samples, samples + numSamples, renderSamples);
+            
+            if (channel == 0)
+                leftRenderChain.process (renderSamples, numSamples);
+            else
+                rightRenderChain.process (renderSamples, numSamples);
+            
+            std::transform (renderSamples, renderSamples + numSamples, samples,
+                            [] (double sample) { return (float) sample; });
+        }
+        
+        measureOutput (buffer, start, numSamples);
+    }
+}
+
+void SimpleEqualizerAudioProcessor::updateMetering()
+{
+    auto enabled = apvts.getRawParameterValue ("Metering Enabled") -> load() > 0.5f;
+    
+    // Drop the readings back to silence when metering is switched off, so the
+    // editor doesn't keep showing stale values.
+    if (meteringEnabled && ! enabled)
+        outputMeter.reset();
+    
+    meteringEnabled = enabled;
+}
+
+void SimpleEqualizerAudioProcessor::measureOutput (juce::AudioBuffer<float>& buffer, int start, int numSamples)
+{
+    if (meteringEnabled)
+        outputMeter.process (buffer.getReadPointer (0, start), buffer.getReadPointer (1, start), numSamples);
+}
+
 juce::AudioProcessorValueTreeState::ParameterLayout SimpleEqualizerAudioProcessor::createParameterLayout()
 {
     juce::AudioProcessorValueTreeState::ParameterLayout layout;
@@ -323,6 +428,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout SimpleEqualizerAudioProcesso
     layout.add (std::make_unique<juce::AudioParameterBool> (ParameterID {"LowPass Bypass", 1}, "LowPass Bypass", false));
     layout.add (std::make_unique<juce::AudioParameterBool> (ParameterID {"Peak Bypass", 1}, "Peak Bypass", false));
     layout.add (std::make_unique<juce::AudioParameterBool> (ParameterID {"Analyzer Enabled", 1}, "Analyzer Enabled", true));
+    layout.add (std::make_unique<juce::AudioParameterBool> (ParameterID {"Metering Enabled", 1}, "Metering Enabled", false));
     
     return layout;
 }
@@ -9,6 +9,10 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "BlockFilter.h"
+#include "OutputMeter.h"
+
+class CallbackTrace;
 
 enum Slope
 {
@@ -43,7 +47,16 @@ enum ChainPositions
 using Coefficients = Filter::CoefficientsPtr;
 void updateCoefficients (Coefficients& old, const Coefficients& replacements);
 
-Coefficients makePeakFilter (const ChainSettings& chainSettings, double sampleRate);
+// The designers are templated on the sample type so the offline render
+// chain can be designed in double; everything else uses the float default.
+template<typename SampleType = float>
+typename juce::dsp::IIR::Coefficients<SampleType>::Ptr makePeakFilter (const ChainSettings& chainSettings, double sampleRate)
+{
+    return juce::dsp::IIR::Coefficients<SampleType>::makePeakFilter (sampleRate,
+                                                                     chainSettings.peakFreq,
+                                                                     chainSettings.peakQuality,
+                                                                     juce::Decibels::decibelsToGain ((SampleType) chainSettings.peakGainInDecibels));
+}
 
 template<int Index, typename ChainType, typename CoefficientType>
 void update (ChainType& chain, const CoefficientType& Coefficients)
@@ -92,18 +105,64 @@ void updatePassFilter (ChainType& leftHighPass,
     }
 }
 
-inline auto makeHighPassFilter (const ChainSettings& chainSettings, double sampleRate)
+template<typename SampleType = float>
+auto makeHighPassFilter (const ChainSettings& chainSettings, double sampleRate)
+{
+    return juce::dsp::FilterDesign<SampleType>::designIIRHighpassHighOrderButterworthMethod (chainSettings.highPassFreq,
+                                                                                             sampleRate,
+                                                                                             2 * (chainSettings.highPassSlope + 1));
+}
+
+template<typename SampleType = float>
+auto makeLowPassFilter (const ChainSettings& chainSettings, double sampleRate)
 {
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod (chainSettings.highPassFreq,
-                                                                                        sampleRate,
-                                                                                        2 * (chainSettings.highPassSlope + 1));
+    return juce::dsp::FilterDesign<SampleType>::designIIRLowpassHighOrderButterworthMethod (chainSettings.lowPassFreq,
+                                                                                            sampleRate,
+                                                                                            2 * (chainSettings.lowPassSlope + 1));
 }
 
-inline auto makeLowPassFilter (const ChainSettings& chainSettings, double sampleRate)
+template<typename SampleType>
+void mirrorPassFilter (BlockMonoChain<SampleType>& blockChain, int offset, const PassFilter& passFilter)
 {
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod (chainSettings.lowPassFreq,
-                                                                                       sampleRate,
-                                                                                       2 * (chainSettings.lowPassSlope + 1));
+    blockChain.setSection (offset + 0, *passFilter.get<0>().coefficients, passFilter.isBypassed<0>());
+    blockChain.setSection (offset + 1, *passFilter.get<1>().coefficients, passFilter.isBypassed<1>());
+    blockChain.setSection (offset + 2, *passFilter.get<2>().coefficients, passFilter.isBypassed<2>());
+    blockChain.setSection (offset + 3, *passFilter.get<3>().coefficients, passFilter.isBypassed<3>());
+    blockChain.setSection (offset + 4, *passFilter.get<4>().coefficients, passFilter.isBypassed<4>());
+    blockChain.setSection (offset + 5, *passFilter.get<5>().coefficients, passFilter.isBypassed<5>());
+}
+
+// Copies the designed coefficients and bypass states of a MonoChain into the
+// block engine, which keeps the same section order.
+template<typename SampleType>
+void mirrorChain (BlockMonoChain<SampleType>& blockChain, const MonoChain& chain)
+{
+    mirrorPassFilter (blockChain, 0, chain.get<ChainPositions::HighPass>());
+    blockChain.setSection (6, *chain.get<ChainPositions::Peak>().coefficients, chain.isBypassed<ChainPositions::Peak>());
+    mirrorPassFilter (blockChain, 7, chain.get<ChainPositions::LowPass>());
+}
+
+template<typename SampleType, typename CoefficientArray>
+void designPassFilter (BlockMonoChain<SampleType>& blockChain, int offset, const CoefficientArray& passCoefficients, Slope slope)
+{
+    // Same layout as updatePassFilter: one section per slope step.
+    for (int i = 0; i < 6; ++i)
+    {
+        if (i <= (int) slope)
+            blockChain.setSection (offset + i, *passCoefficients[i], false);
+        else
+            blockChain.bypassSection (offset + i);
+    }
+}
+
+// Designs the block engine's sections directly in SampleType, rather than
+// widening the float designs a MonoChain holds.
+template<typename SampleType>
+void designChain (BlockMonoChain<SampleType>& blockChain, const ChainSettings& chainSettings, double sampleRate)
+{
+    designPassFilter (blockChain, 0, makeHighPassFilter<SampleType> (chainSettings, sampleRate), chainSettings.highPassSlope);
+    blockChain.setSection (6, *makePeakFilter<SampleType> (chainSettings, sampleRate), false);
+    designPassFilter (blockChain, 7, makeLowPassFilter<SampleType> (chainSettings, sampleRate), chainSettings.lowPassSlope);
 }
 
 //==============================================================================
@@ -151,15 +210,47 @@ public:
     
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
+    
+    const OutputMeter& getOutputMeter() const { return outputMeter; }
 
 private:
+    // Holds the float designs that the realtime block chains mirror.
     MonoChain leftChain, rightChain;
     
+    // Realtime playback always runs through the block engine, which picks
+    // its block path or the plain recurrence per call from the block size
+    // (see BlockBiquad::blockPathThreshold). Unlike the juce::dsp cascade,
+    // its state can be handed to and from the render chain, so switching
+    // in and out of offline rendering never restarts the filters.
+    BlockMonoChain<float> leftBlockChain, rightBlockChain;
+    
+    // Offline renders (isNonRealtime) run the whole chain in double
+    // precision, with the sections designed in double too, converting
+    // through renderBuffer one prepared block at a time. Everything is
+    // allocated in prepareToPlay so switching modes mid-stream never
+    // allocates.
+    bool renderingOffline {false};
+    BlockMonoChain<double> leftRenderChain, rightRenderChain;
+    juce::AudioBuffer<double> renderBuffer;
+    
+    OutputMeter outputMeter;
+    bool meteringEnabled {false};
+    
+    // Only set when SIMPLEEQ_TRACE_FILE is defined, see CallbackTrace.h.
+    std::unique_ptr<CallbackTrace> callbackTrace;
+    
     void updatePeakFilter (const ChainSettings& chainSettings);
     void updateHighPassFilters (const ChainSettings& chainsettings);
     void updateLowPassFilters (const ChainSettings& chainsettings);
     void updateFilters();
     
+    void enterRenderMode();
+    void leaveRenderMode();
+    void processOffline (juce::AudioBuffer<float>& buffer);
+    
+    void updateMetering();
+    void measureOutput (juce::AudioBuffer<float>& buffer, int start, int numSamples);
+    
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimpleEqualizerAudioProcessor)
 };
@@ -0,0 +1,289 @@
+/*
+  ==============================================================================
+
+    Replays a callback trace recorded with SIMPLEEQ_TRACE_FILE through a fresh
+    SimpleEqualizerAudioProcessor, headlessly, and reports how long each
+    callback took compared with the original recording.
+
+    Usage: TraceReplay <trace file> [--csv <per-callback report>]
+           TraceReplay --unit-tests
+           TraceReplay --benchmark
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/CallbackTrace.h"
+
+namespace
+{
+    void applyChainSettings (juce::AudioProcessorValueTreeState& apvts, const ChainSettings& settings, bool meteringEnabled)
+    {
+        auto set = [&apvts] (const juce::String& parameterID, float value)
+        {
+            auto* parameter = apvts.getParameter (parameterID);
+            parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+        };
+        
+        set ("HighPass Freq", settings.highPassFreq);
+        set ("LowPass Freq", settings.lowPassFreq);
+        set ("Peak Freq", settings.peakFreq);
+        set ("Peak Gain", settings.peakGainInDecibels);
+        set ("Peak Quality", settings.peakQuality);
+        set ("HighPass Slope", (float) settings.highPassSlope);
+        set ("LowPass Slope", (float) settings.lowPassSlope);
+        set ("Metering Enabled", meteringEnabled ? 1.f : 0.f);
+    }
+    
+    juce::String getName (CallbackType type)
+    {
+        switch (type)
+        {
+            case CallbackType::Prepare:  return "prepareToPlay";
+            case CallbackType::Process:  return "processBlock";
+            case CallbackType::SetState: return "setStateInformation";
+            case CallbackType::Dropped:  return "dropped";
+        }
+        
+        return {};
+    }
+    
+    struct TimingSummary
+    {
+        std::vector<double> recorded, replayed;
+        
+        static juce::String describe (std::vector<double> micros)
+        {
+            if (micros.empty())
+                return "-";
+            
+            std::sort (micros.begin(), micros.end());
+            auto percentile = [&micros] (double p) { return micros[(size_t) (p * double (micros.size() - 1))]; };
+            auto mean = std::accumulate (micros.begin(), micros.end(), 0.0) / double (micros.size());
+            
+            return "mean " + juce::String (mean, 1)
+                 + " us, p50 " + juce::String (percentile (0.5), 1)
+                 + " us, p99 " + juce::String (percentile (0.99), 1)
+                 + " us, max " + juce::String (micros.back(), 1) + " us";
+        }
+    };
+    
+    // Times the juce::dsp cascade against the block engine for a full chain
+    // (both 36 dB/oct pass filters and the peak) over a range of host block
+    // sizes, taking the best of several runs of the same noise.
+    void runBenchmark()
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int totalSamples = 1 << 20;
+        constexpr int numRuns = 5;
+        
+        ChainSettings settings;
+        settings.highPassFreq = 40.f;
+        settings.lowPassFreq = 16000.f;
+        settings.peakFreq = 1000.f;
+        settings.peakGainInDecibels = 6.f;
+        settings.peakQuality = 1.f;
+        settings.highPassSlope = Slope_36;
+        settings.lowPassSlope = Slope_36;
+        
+        juce::AudioBuffer<float> source (1, totalSamples), samples (1, totalSamples);
+        juce::Random random (1);
+        
+        for (int i = 0; i < totalSamples; ++i)
+            source.setSample (0, i, random.nextFloat() * 2.f - 1.f);
+        
+        juce::ScopedNoDenormals noDenormals;
+        
+        for (auto blockSize : { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 })
+        {
+            juce::dsp::ProcessSpec spec;
+            spec.maximumBlockSize = (juce::uint32) blockSize;
+            spec.numChannels = 1;
+            spec.sampleRate = sampleRate;
+            
+            MonoChain cascade;
+            cascade.prepare (spec);
+            updateCoefficients (cascade.get<ChainPositions::Peak>().coefficients, makePeakFilter (settings, sampleRate));
+            updatePassFilter (cascade.get<ChainPositions::HighPass>(), makeHighPassFilter (settings, sampleRate), settings.highPassSlope);
+            updatePassFilter (cascade.get<ChainPositions::LowPass>(), makeLowPassFilter (settings, sampleRate), settings.lowPassSlope);
+            
+            BlockMonoChain<float> blockChain;
+            mirrorChain (blockChain, cascade);
+            
+            auto time = [&] (auto&& processBlock)
+            {
+                auto best = std::numeric_limits<double>::max();
+                
+                for (int run = 0; run < numRuns; ++run)
+                {
+                    samples.copyFrom (0, 0, source, 0, 0, totalSamples);
+                    
+                    const auto startTicks = juce::Time::getHighResolutionTicks();
+                    
+                    for (int start = 0; start + blockSize <= totalSamples; start += blockSize)
+                        processBlock (samples.getWritePointer (0, start));
+                    
+                    best = juce::jmin (best, juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks));
+                }
+                
+                return best * 1.0e9 / totalSamples;
+            };
+            
+            const auto cascadeNanos = time ([&] (float* data)
+            {
+                juce::dsp::AudioBlock<float> block (&data, 1, (size_t) blockSize);
+                cascade.process (juce::dsp::ProcessContextReplacing<float> (block));
+            });
+            
+            const auto blockNanos = time ([&] (float* data) { blockChain.process (data, blockSize); });
+            
+            std::cout << "block size " << blockSize
+                      << ": cascade " << juce::String (cascadeNanos, 2) << " ns/sample"
+                      << ", block engine " << juce::String (blockNanos, 2) << " ns/sample"
+                      << ", speedup " << juce::String (cascadeNanos / blockNanos, 2) << "x" << std::endl;
+        }
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    // The processors built below would otherwise record the replay itself
+    // into the trace that SIMPLEEQ_TRACE_FILE points at.
+   #if JUCE_WINDOWS
+    _putenv_s ("SIMPLEEQ_TRACE_FILE", "");
+   #else
+    unsetenv ("SIMPLEEQ_TRACE_FILE");
+   #endif
+    
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    
+    juce::StringArray args;
+    for (int i = 1; i < argc; ++i)
+        args.add (argv[i]);
+    
+    if (args.isEmpty())
+    {
+        std::cerr << "Usage: TraceReplay <trace file> [--csv <per-callback report>]" << std::endl
+                  << "       TraceReplay --unit-tests" << std::endl
+                  << "       TraceReplay --benchmark" << std::endl;
+        return 1;
+    }
+    
+    if (args[0] == "--benchmark")
+    {
+        runBenchmark();
+        return 0;
+    }
+    
+    if (args[0] == "--unit-tests")
+    {
+        juce::UnitTestRunner runner;
+        runner.runTestsInCategory ("SimpleEqualizer");
+        
+        for (int i = 0; i < runner.getNumResults(); ++i)
+            if (runner.getResult (i)->failures > 0)
+                return 1;
+        
+        return 0;
+    }
+    
+    std::vector<CallbackEvent> events;
+    juce::int64 recordedTicksPerSecond = 0;
+    int droppedEvents = 0;
+    
+    auto result = CallbackTrace::read (juce::File::getCurrentWorkingDirectory().getChildFile (args[0]),
+                                       events, recordedTicksPerSecond, droppedEvents);
+    
+    if (result.failed())
+    {
+        std::cerr << result.getErrorMessage() << std::endl;
+        return 1;
+    }
+    
+    if (droppedEvents > 0)
+        std::cout << "warning: the recorder dropped " << droppedEvents
+                  << " processBlock events, so the replay is incomplete" << std::endl;
+    
+    std::unique_ptr<juce::FileOutputStream> csv;
+    auto csvIndex = args.indexOf ("--csv");
+    
+    if (csvIndex >= 0 && csvIndex + 1 < args.size())
+    {
+        auto csvFile = juce::File::getCurrentWorkingDirectory().getChildFile (args[csvIndex + 1]);
+        csvFile.deleteFile();
+        csv = std::make_unique<juce::FileOutputStream> (csvFile);
+        *csv << "sequence,callback,numSamples,recordedMicros,replayedMicros\n";
+    }
+    
+    // Size the buffer once for the largest block in the trace, so that
+    // allocation never shows up in the replayed timings.
+    auto maxBlockSize = 0;
+    for (const auto& event : events)
+        maxBlockSize = juce::jmax (maxBlockSize, event.numSamples);
+    
+    SimpleEqualizerAudioProcessor processor;
+    juce::AudioBuffer<float> buffer (2, juce::jmax (1, maxBlockSize));
+    juce::MidiBuffer midi;
+    juce::Random random (1);
+    
+    std::map<CallbackType, TimingSummary> summaries;
+    
+    for (const auto& event : events)
+    {
+        juce::int64 startTicks = 0;
+        
+        switch (event.type)
+        {
+            case CallbackType::Prepare:
+                processor.setRateAndBufferSizeDetails (event.sampleRate, event.numSamples);
+                startTicks = juce::Time::getHighResolutionTicks();
+                processor.prepareToPlay (event.sampleRate, event.numSamples);
+                break;
+                
+            case CallbackType::Process:
+            {
+                applyChainSettings (processor.apvts, event.settings, event.meteringEnabled);
+                processor.setNonRealtime (event.nonRealtime);
+                buffer.setSize (2, event.numSamples, false, false, true);
+                
+                for (int channel = 0; channel < 2; ++channel)
+                    for (int i = 0; i < event.numSamples; ++i)
+                        buffer.setSample (channel, i, random.nextFloat() * 2.f - 1.f);
+                
+                startTicks = juce::Time::getHighResolutionTicks();
+                processor.processBlock (buffer, midi);
+                break;
+            }
+                
+            case CallbackType::SetState:
+                startTicks = juce::Time::getHighResolutionTicks();
+                processor.setStateInformation (event.state.getData(), (int) event.state.getSize());
+                break;
+                
+            case CallbackType::Dropped:
+                // read() folds these into droppedEvents.
+                continue;
+        }
+        
+        auto replayedMicros = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks) * 1.0e6;
+        auto recordedMicros = double (event.durationTicks) * 1.0e6 / double (recordedTicksPerSecond);
+        
+        auto& summary = summaries[event.type];
+        summary.recorded.push_back (recordedMicros);
+        summary.replayed.push_back (replayedMicros);
+        
+        if (csv != nullptr)
+            *csv << (int) event.sequence << "," << getName (event.type) << "," << event.numSamples << ","
+                 << juce::String (recordedMicros, 2) << "," << juce::String (replayedMicros, 2) << "\n";
+    }
+    
+    for (const auto& [type, summary] : summaries)
+    {
+        std::cout << getName (type) << " x " << summary.replayed.size() << std::endl
+                  << "  recorded: " << TimingSummary::describe (summary.recorded) << std::endl
+                  << "  replayed: " << TimingSummary::describe (summary.replayed) << std::endl;
+    }
+    
+    return 0;
+}